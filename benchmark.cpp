@@ -0,0 +1,390 @@
+#include <cstddef> // for the std::size_t data type
+#include <algorithm> // for std::min
+#include <array> // for std::array
+#include <chrono>
+#include <cmath> // for std::fabs
+#include <cstdlib> // for EXIT_SUCCESS and EXIT_FAILURE
+#include <iostream>
+#include <limits> // for std::numeric_limits
+#include <sstream> // for std::ostringstream
+#include <vector>
+
+#include "vec3.hpp"
+#include "state.hpp"
+
+#include "solver_core.hpp"
+#include "pipeline.hpp"
+#include "steppers.hpp"
+#include "trajectory.hpp"
+
+// This is the benchmark harness for the solver_core library. It runs the same problem as main.cpp
+// (an electron gyrating in a constant B field) through the different ways a field can be handed
+// to the solvers, so that the cost of each of them is known before it gets used somewhere that
+// matters.
+
+constexpr std::size_t numSteps = 1'000'000;
+constexpr std::size_t numRepetitions = 5;
+constexpr double speed_of_light = 299'792'458; // units: m/s
+double mass = 9.109e-31; // units: kg
+double charge = 1.602e-19; // units: C
+
+std::array<double, 3> B(const double /* t */) {
+	return {0, 0, 1};
+}
+
+std::array<double, 3> E(const double /* t */) {
+	return {0, 0, 0};
+}
+
+// A mixed field for the subcycling solver: a weak B field everywhere, except for a strong one
+// for x > 1 cm
+std::array<double, 3> mixedB(const std::array<double, 3> x, const double /* t */) {
+	return {0, 0, x[0] > 0.01 ? 10.0 : 0.1};
+}
+
+std::array<double, 3> mixedE(const std::array<double, 3> /* x */, const double /* t */) {
+	return {0, 0, 0};
+}
+
+// A field which is the same everywhere and at all times. The solvers take E and B as the same
+// type, so this is used instead of two lambdas (which would have two different types).
+struct UniformField {
+	std::array<double, 3> value;
+
+	std::array<double, 3> operator()(const double /* t */) const {
+		return value;
+	}
+};
+
+// An analysis stage for the pipeline: it keeps track of how far the length of the momentum
+// strays from the length it started out with
+struct MomentumDeviation {
+	double initialMomentum = 0;
+	double maxDeviation = 0;
+
+	void operator()(const Solver::StateBlock& block) {
+		for (std::size_t i = 0; i < block.count; ++i) {
+			double momentum = block.states[i].getMomentum().length();
+			if (block.firstStep + i == 0) {
+				initialMomentum = momentum;
+			}
+			maxDeviation = std::max(maxDeviation, std::fabs(momentum - initialMomentum));
+		}
+	}
+};
+
+// A deliberately slow output stage for the pipeline, standing in for a writer which formats
+// every state as text
+struct TextWriter {
+	std::size_t numBytes = 0;
+
+	void operator()(const Solver::StateBlock& block) {
+		std::ostringstream out;
+		for (std::size_t i = 0; i < block.count; ++i) {
+			out << block.firstStep + i << ' ' << block.states[i] << '\n';
+		}
+		numBytes += out.str().size();
+	}
+};
+
+// Writing the results into a volatile stops the compiler from optimising the work away
+volatile double sink;
+
+template <typename Function>
+double bestTime(Function func) {
+	// Runs func numRepetitions times and returns the fastest run in seconds. The fastest run is
+	// the one with the least noise from everything else running on the machine.
+	double best = std::numeric_limits<double>::max();
+
+	for (std::size_t i = 0; i < numRepetitions; ++i) {
+		auto start = std::chrono::steady_clock::now();
+		func();
+		auto end = std::chrono::steady_clock::now();
+		best = std::min(best, std::chrono::duration<double>(end - start).count());
+	}
+
+	return best;
+}
+
+void report(const char* name, const double seconds, const std::size_t count) {
+	std::cout << name << "\t" << seconds * 1e9 / count << " ns\n";
+}
+
+template <typename Trajectory>
+void benchmarkCompression(const char* name, Trajectory trajectory, const std::vector<State>& values) {
+	for (const auto& state : values) {
+		trajectory.push_back(state);
+	}
+
+	std::cout << name << ":\n";
+	std::cout << "Compression ratio:\t" << trajectory.compressionRatio() << " ("
+			  << trajectory.compressedBytes() << " bytes instead of "
+			  << trajectory.uncompressedBytes() << ")\n";
+
+	report("Full decode (per state):", bestTime([&] {
+		sink = trajectory.decode().back()[0];
+	}), values.size());
+
+	// Jumping around the trajectory like the lookups in main.cpp do, but many more of them
+	constexpr std::size_t numLookups = 100'000;
+	report("Random access (per lookup):", bestTime([&] {
+		double total = 0;
+		for (std::size_t i = 0; i < numLookups; ++i) {
+			total += trajectory[(i * 7'919) % values.size()][0];
+		}
+		sink = total;
+	}), numLookups);
+	std::cout << '\n';
+}
+
+int main() {
+	constexpr double t0 = 0;
+	bool pararealFailed = false;
+	// main.cpp takes only 4 steps per turn. Over a million steps RK4 damps the momentum at that
+	// step size until it is denormal, and then the benchmark would be timing the slow path of
+	// the FPU instead of the solvers, so this uses a finer step.
+	constexpr double tStep = 8.93e-12 / 64;
+	const vec3 initialMomentum = mass * (0.9 * speed_of_light) * vec3{0, 1, 0};
+	const State initialState({0, 0, 0}, initialMomentum);
+
+	// The same fields as E and B, as function objects (which the solvers get instantiated for
+	// right here), as function pointers and as FieldRefs (which both come precompiled from
+	// solver_core)
+	const UniformField EObject{{0, 0, 0}};
+	const UniformField BObject{{0, 0, 1}};
+	const Solver::FieldPointer EPointer = E;
+	const Solver::FieldPointer BPointer = B;
+	const Solver::FieldRef ERef = EObject;
+	const Solver::FieldRef BRef = BObject;
+
+	std::cout << "Field function call (per call):\n";
+	report("Function object:", bestTime([&] {
+		double total = 0;
+		for (std::size_t i = 0; i < numSteps; ++i) {
+			total += BObject(i * tStep)[2];
+		}
+		sink = total;
+	}), numSteps);
+	report("Function pointer:", bestTime([&] {
+		double total = 0;
+		for (std::size_t i = 0; i < numSteps; ++i) {
+			total += BPointer(i * tStep)[2];
+		}
+		sink = total;
+	}), numSteps);
+	report("FieldRef:\t", bestTime([&] {
+		double total = 0;
+		for (std::size_t i = 0; i < numSteps; ++i) {
+			total += BRef(i * tStep)[2];
+		}
+		sink = total;
+	}), numSteps);
+	std::cout << '\n';
+
+	std::cout << "Boris leapfrog (per step):\n";
+	report("Function object:", bestTime([&] {
+		sink = Solver::LeapFrog(initialState, t0, tStep, numSteps, EObject, BObject).back()[0];
+	}), numSteps);
+	report("Function pointer:", bestTime([&] {
+		sink = Solver::LeapFrog(initialState, t0, tStep, numSteps, EPointer, BPointer).back()[0];
+	}), numSteps);
+	report("FieldRef:\t", bestTime([&] {
+		sink = Solver::LeapFrog(initialState, t0, tStep, numSteps, ERef, BRef).back()[0];
+	}), numSteps);
+	std::cout << '\n';
+
+	std::cout << "RK4 (per step):\n";
+	report("Function object:", bestTime([&] {
+		sink = Solver::RK4(initialState, t0, tStep, numSteps, EObject, BObject).back()[0];
+	}), numSteps);
+	report("Function pointer:", bestTime([&] {
+		sink = Solver::RK4(initialState, t0, tStep, numSteps, EPointer, BPointer).back()[0];
+	}), numSteps);
+	report("FieldRef:\t", bestTime([&] {
+		sink = Solver::RK4(initialState, t0, tStep, numSteps, ERef, BRef).back()[0];
+	}), numSteps);
+	std::cout << '\n';
+
+	// Parareal against the serial solver it stands in for. The wall time only improves with a
+	// free core for every slice, so the critical path speedup is reported as well: that is the
+	// speedup the run would get with enough cores.
+	{
+		Solver::PararealOptions options;
+		options.numSlices = std::max(std::thread::hardware_concurrency(), 2u);
+
+		std::cout << "Parareal Boris leapfrog (per step, " << options.numSlices << " slices, "
+				  << std::thread::hardware_concurrency() << " hardware threads):\n";
+		report("Serial:\t\t", bestTime([&] {
+			sink = Solver::LeapFrog(initialState, t0, tStep, numSteps, EPointer, BPointer).back()[0];
+		}), numSteps);
+
+		Solver::PararealResult result;
+		report("Parareal:\t", bestTime([&] {
+			result = Solver::Parareal(initialState, t0, tStep, numSteps, EPointer, BPointer, options);
+			sink = result.values.back()[0];
+		}), numSteps);
+		std::cout << "Iterations:\t\t" << result.iterations
+				  << (result.converged ? "" : " (not converged)") << '\n';
+		std::cout << "Critical path speedup:\t"
+				  << static_cast<double>(numSteps) / result.criticalPathSteps << "\n\n";
+
+		// Whenever Parareal says it converged, its trajectory has to be the serial one (up to the
+		// tolerance), whichever propagators it was run with. This always uses 8 slices, since with
+		// only a couple of slices the first iterations already give the exact serial solution.
+		auto propagatorName = [](const Solver::Propagator method) {
+			return method == Solver::Propagator::LeapFrog ? "LeapFrog" : "RK4";
+		};
+
+		std::cout << "Parareal against the serial solver (largest deviation / orbit size):\n";
+		for (const auto fine : {Solver::Propagator::LeapFrog, Solver::Propagator::RK4}) {
+			const std::vector<State> serial = fine == Solver::Propagator::LeapFrog
+					? Solver::LeapFrog(initialState, t0, tStep, numSteps, EPointer, BPointer)
+					: Solver::RK4(initialState, t0, tStep, numSteps, EPointer, BPointer);
+
+			for (const auto coarse : {Solver::Propagator::LeapFrog, Solver::Propagator::RK4}) {
+				Solver::PararealOptions checkOptions;
+				checkOptions.numSlices = 8;
+				checkOptions.fine = fine;
+				checkOptions.coarse = coarse;
+				result = Solver::Parareal(initialState, t0, tStep, numSteps, EPointer, BPointer,
+						checkOptions);
+
+				double deviation = 0;
+				double orbitSize = 0;
+				for (std::size_t i = 0; i <= numSteps; ++i) {
+					deviation = std::max(deviation,
+							(result.values[i].getPosition() - serial[i].getPosition()).length());
+					orbitSize = std::max(orbitSize, serial[i].getPosition().length());
+				}
+
+				std::cout << "Fine " << propagatorName(fine) << ", coarse " << propagatorName(coarse)
+						  << ":\t" << deviation / orbitSize << " after " << result.iterations
+						  << " iterations" << (result.converged ? "" : " (not converged)") << '\n';
+				if (result.converged && deviation > 1e-6 * orbitSize) {
+					std::cout << "Parareal converged to the wrong trajectory!\n";
+					pararealFailed = true;
+				}
+			}
+		}
+		std::cout << '\n';
+	}
+
+	// Subcycling on a beam where a tenth of the particles sit in the strong part of mixedB. With
+	// the default options, the particles in the weak field get away with the base step, while
+	// the others need 32 substeps per base step.
+	{
+		constexpr std::size_t numParticles = 1'000;
+		constexpr std::size_t numBaseSteps = 1'000;
+		constexpr double baseStep = 1e-12;
+
+		std::vector<State> beam;
+		beam.reserve(numParticles);
+		for (std::size_t i = 0; i < numParticles; ++i) {
+			const vec3 position{i < numParticles / 10 ? 0.02 : 0.0, 0, 0};
+			beam.emplace_back(position, mass * vec3{0, 1e5, 0});
+		}
+
+		const Solver::SpatialFieldPointer EMixed = mixedE;
+		const Solver::SpatialFieldPointer BMixed = mixedB;
+
+		Solver::SubcyclingResult result;
+		std::cout << "Subcycling (" << numParticles << " particles, 10% in the strong field):\n";
+		double seconds = bestTime([&] {
+			result = Solver::Subcycling(beam, t0, baseStep, numBaseSteps, EMixed, BMixed);
+			sink = result.finalStates.back()[0];
+		});
+		std::cout << "Pushes:\t\t\t" << result.numPushes << " instead of "
+				  << result.numUniformPushes << " with one global step\n";
+		report("Per push:\t", seconds, result.numPushes);
+		std::cout << '\n';
+	}
+
+	// The pipeline runs the analysis and output stages on their own threads, so the numbers
+	// below only make sense on a machine with a free core for every stage
+	std::cout << "Pipelined Boris leapfrog (per step, " << std::thread::hardware_concurrency()
+			  << " hardware threads):\n";
+	report("No sinks:\t", bestTime([&] {
+		sink = Solver::Pipelined(initialState, t0, tStep, numSteps, EObject, BObject,
+				Solver::Propagator::LeapFrog)[0];
+	}), numSteps);
+	report("Analysis:\t", bestTime([&] {
+		MomentumDeviation deviation;
+		sink = Solver::Pipelined(initialState, t0, tStep, numSteps, EObject, BObject,
+				Solver::Propagator::LeapFrog, deviation)[0];
+	}), numSteps);
+	report("Analysis + writer:", bestTime([&] {
+		MomentumDeviation deviation;
+		TextWriter writer;
+		sink = Solver::Pipelined(initialState, t0, tStep, numSteps, EObject, BObject,
+				Solver::Propagator::LeapFrog, deviation, writer)[0];
+	}), numSteps);
+	std::size_t numDropped = 0;
+	report("Analysis + lossy writer:", bestTime([&] {
+		MomentumDeviation deviation;
+		TextWriter writer;
+		Solver::LossySink<TextWriter> lossyWriter{writer};
+		sink = Solver::Pipelined(initialState, t0, tStep, numSteps, EObject, BObject,
+				Solver::Propagator::LeapFrog, deviation, lossyWriter)[0];
+		numDropped = lossyWriter.numDropped;
+	}), numSteps);
+	std::cout << "Blocks dropped:\t\t" << numDropped << " of "
+			  << (numSteps + Solver::StateBlock::blockSize) / Solver::StateBlock::blockSize << '\n';
+	std::cout << '\n';
+
+	// The compressed trajectory store, on the same trajectory main.cpp keeps around: 40,000 steps
+	// of 8.93e-12 s. The error bounds are about a millionth of the radius of the orbit and a
+	// billionth of the momentum.
+	{
+		constexpr double mainStep = 8.93e-12;
+		constexpr std::size_t mainNumSteps = 40'000;
+		constexpr double positionError = 1e-9; // units: m
+		constexpr double momentumError = 1e-31; // units: kg m/s
+
+		std::vector<State> values = Solver::LeapFrog(initialState, t0, mainStep, mainNumSteps,
+				EPointer, BPointer);
+
+		benchmarkCompression("Compressed trajectory, linear predictor",
+				Solver::CompressedTrajectory<>(positionError, momentumError), values);
+		benchmarkCompression("Compressed trajectory, Boris predictor",
+				Solver::CompressedTrajectory<Solver::BorisPredictor<Solver::FieldPointer>>(
+					positionError, momentumError, {EPointer, BPointer, t0, mainStep}), values);
+	}
+
+	// The cost of picking the integration method at runtime. Lots of tiny groups (one particle,
+	// a few steps each) make the std::visit in IntegrateGroup as expensive as it can possibly be
+	// relative to the integration, which is then compared against calling the method directly.
+	// The fields are function objects, so that the step and the fields can be inlined into both
+	// loops, and the difference between them is down to the std::visit alone. With the precompiled
+	// field types, both would make an out-of-line call per particle per step.
+	{
+		constexpr std::size_t numGroups = 100'000;
+		constexpr std::size_t stepsPerGroup = 4;
+
+		std::vector<Solver::LeapFrogMethod<UniformField>> methods(numGroups, {EObject, BObject});
+		std::vector<std::vector<State>> directGroups(numGroups, {initialState});
+		std::vector<Solver::ParticleGroup<UniformField>> groups(numGroups,
+				{*Solver::MakeMethod("leapfrog", EObject, BObject), {initialState}});
+
+		std::cout << "Method dispatch (per group of 1 particle, " << stepsPerGroup << " steps):\n";
+		double direct = bestTime([&] {
+			for (std::size_t i = 0; i < numGroups; ++i) {
+				double currentTime = t0;
+				for (std::size_t j = 0; j < stepsPerGroup; ++j) {
+					methods[i].doStep(directGroups[i], currentTime, tStep);
+					currentTime += tStep;
+				}
+			}
+			sink = directGroups.back()[0][0];
+		});
+		double dispatched = bestTime([&] {
+			Solver::IntegrateGroups(groups, t0, tStep, stepsPerGroup);
+			sink = groups.back().states[0][0];
+		});
+		report("Direct call:\t", direct, numGroups);
+		report("std::variant:\t", dispatched, numGroups);
+		report("Overhead:\t", dispatched - direct, numGroups);
+		std::cout << '\n';
+	}
+
+	return pararealFailed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
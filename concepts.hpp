@@ -1,6 +1,8 @@
 #ifndef CONCEPTS_HPP
 #define CONCEPTS_HPP
 
+#include <array> // for std::array
+
 // These ifdef tests are feature test macros (which are guaranteed to exist
 // in any ISO C++ conforming implementation), testing to see if C++ concepts
 // are implemented in the compiler. If they are not, then this code is not 
@@ -12,7 +14,11 @@
 // I decided to use C++ concepts (if they are available) to make error messages
 // (if the compiler emits any) more readable.
 #ifdef __cpp_lib_concepts
-	#include <concepts> // for std::same_as
+	#include <concepts> // for std::same_as and std::convertible_to
+	#include <string_view>
+	#include <vector>
+
+	#include "state.hpp"
 #endif
 
 namespace Solver {
@@ -21,13 +27,12 @@ namespace Solver {
  * function describing the Electric and Magnetic Fields.
  *
  * For the purposes of this assignment, I chose to make it so that the E and B
- * fields can vary with time, but not with spatial coordinates.
+ * fields taken by most of the solvers (RK4, LeapFrog, Parareal, ...) can vary with
+ * time, but not with spatial coordinates.
  *
- * Allowing for spatially as well as time-dependent E and B field will not
- * require too much of a modification to the existing code. However, since the
- * assignment did not require us to generalize the project as much as possible,
- * the current version of the project as it stands only allows for time-varying
- * E and B fields.
+ * Fields which vary with the position as well are described by the SpatialEMFunc
+ * concept further down. For now, only the subcycling solver (subcycling.hpp) takes
+ * those, since it is the one which needs them to pick a step size per particle.
  * 
  * The current concept requires E and B functions to depend on only one parameter,
  * which must be of double type. This is supposed to be the time at which we want
@@ -39,6 +44,36 @@ namespace Solver {
 	concept EMFunc = requires (FunctionType func, const double t) {
 		{ func(t) } -> std::same_as<std::array<double, 3>>;
 	};
+
+/**
+ * The spatially varying counterpart of EMFunc, for the solvers which need to know the
+ * field at the position of each particle (e.g. the subcycling solver, which picks the
+ * step size of a particle from the strength of the B field it currently sits in).
+ *
+ * The function takes the position of the particle as a std::array of 3 doubles and the
+ * time as a double, and returns the field as a std::array of 3 doubles, just like EMFunc.
+ */
+	template <typename FunctionType>
+	concept SpatialEMFunc = requires (FunctionType func, const std::array<double, 3> x, const double t) {
+		{ func(x, t) } -> std::same_as<std::array<double, 3>>;
+	};
+
+/**
+ * A C++ concept for the integration methods in steppers.hpp, which all integrate a whole
+ * group of particles at once, so that one run can pick a different method for every group.
+ *
+ * A stepper needs a name (which is what the registry in steppers.hpp looks it up by), a
+ * reset member function, which gets it ready for a new run of a group of numParticles
+ * particles (multistep methods throw their history away here), and a doStep member
+ * function, which advances every State in the group by one step of tStep starting at time t.
+ */
+	template <typename StepperType>
+	concept Stepper = requires (StepperType stepper, std::vector<State>& states,
+			const double t, const double tStep) {
+		{ StepperType::name } -> std::convertible_to<std::string_view>;
+		stepper.reset(states.size());
+		stepper.doStep(states, t, tStep);
+	};
 #endif
 }
 #endif // CONCEPTS_HPP
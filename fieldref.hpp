@@ -0,0 +1,63 @@
+#ifndef FIELDREF_HPP
+#define FIELDREF_HPP
+
+#include <cstddef> // for the std::size_t and std::max_align_t data types
+#include <array> // for std::array
+#include <new> // for placement new
+#include <type_traits> // for std::enable_if_t, std::is_invocable_r_v and friends
+
+namespace Solver {
+	/**
+	 * A type-erased handle to an E or B field function, for fields which are only known at runtime
+	 * (e.g. read from a configuration file), where the solvers can't be instantiated for the exact
+	 * type of the field.
+	 *
+	 * Unlike std::function, this class never allocates. The callable is copied into a small buffer
+	 * inside the handle, so only function pointers and small, trivially copyable function objects
+	 * (like lambdas capturing a few doubles or a pointer) can be stored. Anything bigger should be
+	 * kept alive somewhere else and wrapped in a lambda which captures it by reference. Calling the
+	 * field costs one indirect call, which is what the benchmark in benchmark.cpp measures.
+	 *
+	 * Args are the parameters of the field function, so FieldRef matches the EMFunc concept and
+	 * SpatialFieldRef matches the SpatialEMFunc concept in concepts.hpp.
+	 */
+	template <typename... Args>
+	class BasicFieldRef {
+		public:
+			static constexpr std::size_t bufferSize = 4 * sizeof(void*);
+
+			// Only field functions (i.e. things which can be called with Args and give back a
+			// std::array<double, 3>) can be turned into a BasicFieldRef, so that something like
+			// FieldRef r = 42; doesn't compile, and a BasicFieldRef is copied rather than wrapped
+			template <typename FunctionType, typename = std::enable_if_t<
+				!std::is_same_v<std::decay_t<FunctionType>, BasicFieldRef> &&
+				std::is_invocable_r_v<std::array<double, 3>, const FunctionType&, Args...>>>
+			BasicFieldRef(FunctionType func) noexcept {
+				static_assert(sizeof(FunctionType) <= bufferSize,
+						"The field function is too big to be stored inside a FieldRef");
+				static_assert(alignof(FunctionType) <= alignof(std::max_align_t),
+						"The field function is over-aligned and cannot be stored inside a FieldRef");
+				static_assert(std::is_trivially_copyable_v<FunctionType>,
+						"The field function must be trivially copyable to be stored inside a FieldRef");
+
+				::new (static_cast<void*>(m_buffer)) FunctionType(func);
+				m_invoke = [](const void* buffer, Args... args) -> std::array<double, 3> {
+					return (*static_cast<const FunctionType*>(buffer))(args...);
+				};
+			}
+
+			std::array<double, 3> operator()(Args... args) const {
+				return m_invoke(m_buffer, args...);
+			}
+
+		private:
+			alignas(std::max_align_t) unsigned char m_buffer[bufferSize];
+			std::array<double, 3> (*m_invoke)(const void*, Args...);
+	};
+
+	// A time-dependent field, i.e. the kind of function the EMFunc concept describes
+	using FieldRef = BasicFieldRef<double>;
+	// A field which depends on both position and time (see the SpatialEMFunc concept)
+	using SpatialFieldRef = BasicFieldRef<std::array<double, 3>, double>;
+}
+#endif // FIELDREF_HPP
@@ -18,24 +18,13 @@ namespace Solver {
 // These ifdef clauses conditionally use the concepts defined in concepts.hpp if the compiler
 // supports C++ concepts. All the functions in this header use concepts if they are there, and
 // use normal template parameters if they are not implemented in the compiler.
-#ifdef __cpp_lib_concepts
-	template <typename Callable> requires EMFunc<Callable>
-#else
-	template <typename Callable>
-#endif
 	/**
-     * This function does one step of the Boris LeapFrog algorithm. This is analogous to the do_step
-	 * function in the Boost odeint library.
-     */
-	State LeapFrogStepper(const State& currentState, const double t, const double tStep,
-			Callable EFunc, Callable BFunc) {
-		// Query the function which returns the value of E for the current value
-		// of E and store it inside EField
-		vec3 EField = EFunc(t);
-		// Query the function which returns the value of B for the current value
-		// of B and store it inside BField
-		vec3 BField = BFunc(t);
-
+	 * This function does the actual Boris push for one step, given the values of the E and B fields
+	 * which act on the particle during that step. It is split out from LeapFrogStepper so that the
+	 * solvers which evaluate the fields at the position of the particle can share it.
+	 */
+	inline State BorisPush(const State& currentState, const vec3& EField, const vec3& BField,
+			const double tStep) {
 		vec3 h = (charge / (2 * mass)) * BField * tStep;
 		vec3 s = (2 * h) / (1 + h.lengthSquared());
 
@@ -55,6 +44,27 @@ namespace Solver {
 		return newState;
 	}
 
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires EMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+     * This function does one step of the Boris LeapFrog algorithm. This is analogous to the do_step
+	 * function in the Boost odeint library.
+     */
+	State LeapFrogStepper(const State& currentState, const double t, const double tStep,
+			Callable EFunc, Callable BFunc) {
+		// Query the function which returns the value of E for the current value
+		// of E and store it inside EField
+		vec3 EField = EFunc(t);
+		// Query the function which returns the value of B for the current value
+		// of B and store it inside BField
+		vec3 BField = BFunc(t);
+
+		return BorisPush(currentState, EField, BField, tStep);
+	}
+
 #ifdef __cpp_lib_concepts
 	template <typename Callable> requires EMFunc<Callable>
 #else
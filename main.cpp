@@ -12,6 +12,7 @@
 
 #include "rk4.hpp"
 #include "leapfrog.hpp"
+#include "solver_core.hpp" // for the precompiled instantiations of the solvers
 
 typedef std::array<double, 6> StateType;
 // originally, this was a boost::array, but then Boost documentation itself
@@ -0,0 +1,385 @@
+#ifndef PARAREAL_HPP
+#define PARAREAL_HPP
+
+#include <cstddef> // for the std::size_t data type
+#include <algorithm> // for std::max, std::min and std::clamp
+#include <cmath> // for std::fabs, std::atan, std::tan and std::floor
+#include <thread>
+#include <vector>
+
+#include "concepts.hpp"
+#include "state.hpp"
+#include "vec3.hpp"
+
+#include "leapfrog.hpp"
+#include "propagator.hpp"
+
+namespace Solver {
+	/**
+	 * The knobs of the Parareal driver.
+	 *
+	 * numSlices is the number of time slices the trajectory is cut into. Each slice is handed to
+	 * its own thread during the fine sweeps, so this should usually be the number of cores.
+	 *
+	 * coarseFactor is the most fine steps one coarse step may cover. The coarse propagator has to
+	 * be run serially, so it has to be much cheaper than the fine one for Parareal to be worth it.
+	 * On top of that, a coarse step may not turn the particle by more than maxCoarsePhase radians
+	 * around the B field (like maxPhasePerStep in subcycling.hpp), which has to stay below pi.
+	 * Past that, a big Boris step no longer follows the gyration at all, and Parareal needs about
+	 * as many iterations as there are slices, i.e. it ends up slower than the serial solver. A
+	 * coarse RK4 step is held to the much smaller maxPararealRK4CoarsePhase on top of that.
+	 *
+	 * The iterations stop as soon as the fine trajectory is continuous to within tolerance, i.e.
+	 * the largest relative jump between the end of a slice and the start of the next one drops
+	 * below tolerance, or after maxIterations sweeps, whichever comes first. Parareal always
+	 * reproduces the serial fine solution after numSlices iterations, so there is no point in
+	 * setting maxIterations higher than that.
+	 */
+	struct PararealOptions {
+		std::size_t numSlices = 8;
+		std::size_t coarseFactor = 32;
+		double maxCoarsePhase = 2.0;
+		double tolerance = 1e-10;
+		std::size_t maxIterations = 4;
+		Propagator coarse = Propagator::LeapFrog;
+		Propagator fine = Propagator::LeapFrog;
+	};
+
+	/**
+	 * What the Parareal driver hands back: the full fine trajectory (in the same layout as the one
+	 * returned by Solver::LeapFrog and Solver::RK4), along with how many iterations it took and
+	 * whether the tolerance was actually reached.
+	 *
+	 * criticalPathSteps is the number of steps (coarse and fine) on the longest chain of steps
+	 * which have to be done one after another, assuming every slice gets its own core. The serial
+	 * solver's critical path is numSteps, so numSteps / criticalPathSteps is the speedup the run
+	 * can reach with enough cores. It is 0 iterations and numSteps if the driver fell back to the
+	 * serial solver.
+	 */
+	struct PararealResult {
+		std::vector<State> values;
+		std::size_t iterations;
+		bool converged;
+		std::size_t criticalPathSteps;
+	};
+
+	// The largest coarse phase the driver accepts. A Boris step turns the particle by
+	// 2 atan(omega tStep / 2), which can't reach pi, so the phase matching below needs some room.
+	constexpr double maxPararealCoarsePhase = 3.0;
+
+	// The largest coarse phase for an RK4 coarse step. RK4 isn't phase matched like the coarse
+	// Boris step, and it shrinks the momentum by a factor of about 1 - phase^6 / 144 every step.
+	// At a phase of 2 that is a factor of 0.55, and a few hundred coarse steps squash every coarse
+	// prediction onto the gyrocentre, while at 0.5 it is lost in the Parareal correction.
+	constexpr double maxPararealRK4CoarsePhase = 0.5;
+
+	/**
+	 * This function works out the angle the fine propagator turns the particle by in one step of
+	 * tStep in the field BField. The Boris step turns it by 2 atan(omega tStep / 2) rather than
+	 * omega tStep, and the coarse propagator has to match the fine one, not the exact solution.
+	 */
+	inline double FinePhasePerStep(const Propagator fine, const vec3& BField, const double tStep) {
+		double omegaStep = std::fabs(charge) * BField.length() / mass * tStep;
+
+		if (fine == Propagator::LeapFrog) {
+			return 2 * std::atan(omegaStep / 2);
+		}
+		return omegaStep;
+	}
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires EMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+	 * This function works out how many fine steps a coarse step starting at time t may cover:
+	 * options.coarseFactor, unless that would turn the particle by more than
+	 * options.maxCoarsePhase (or the limit of the coarse propagator, if that is smaller). The
+	 * answer is always at least 1.
+	 */
+	std::size_t CoarseFactor(const PararealOptions& options, const double t, const double tStep,
+			Callable BFunc) {
+		const double maxFactor = static_cast<double>(std::max<std::size_t>(options.coarseFactor, 1));
+		const double maxPhase = std::min(options.maxCoarsePhase,
+				options.coarse == Propagator::RK4 ? maxPararealRK4CoarsePhase : maxPararealCoarsePhase);
+		const double phase = FinePhasePerStep(options.fine, BFunc(t), tStep);
+
+		if (!(phase > 0)) {
+			return static_cast<std::size_t>(maxFactor);
+		}
+
+		// The clamping is done in floating point, since the ratio can be huge (or negative, for a
+		// nonsensical maxCoarsePhase) and would overflow the conversion to std::size_t
+		return static_cast<std::size_t>(std::clamp(std::floor(maxPhase / phase), 1.0, maxFactor));
+	}
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires EMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+	 * This function works out how many coarse steps the coarse propagator takes to cover numSteps
+	 * fine steps starting at time t.
+	 */
+	std::size_t NumCoarseSteps(const PararealOptions& options, const double t, const double tStep,
+			const std::size_t numSteps, Callable BFunc) {
+		const std::size_t factor = CoarseFactor(options, t, tStep, BFunc);
+		return std::max<std::size_t>((numSteps + factor - 1) / factor, 1);
+	}
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires EMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+	 * The coarse propagator. It covers numSteps fine steps starting at time t with roughly
+	 * numSteps / CoarseFactor big steps. The big step is stretched a little if the factor does
+	 * not divide numSteps, so that the coarse and fine propagators always end at the same time.
+	 *
+	 * A coarse Boris step is phase matched: the B field is scaled so that the big step turns the
+	 * particle by exactly as much as the fine steps it stands in for would have. A plain big Boris
+	 * step turns it by less, and over a long gyration that phase error is what keeps Parareal from
+	 * converging. With the phase matched, the coarse propagator is only off by a small, bounded
+	 * amount in the position, which the Parareal correction removes in an iteration or two.
+	 */
+	State CoarsePropagate(const PararealOptions& options, State state, const double t,
+			const double tStep, const std::size_t numSteps, Callable EFunc, Callable BFunc) {
+		const std::size_t numCoarseSteps = NumCoarseSteps(options, t, tStep, numSteps, BFunc);
+		const double coarseStep = numSteps * tStep / numCoarseSteps;
+		const double stepsPerCoarseStep = static_cast<double>(numSteps) / numCoarseSteps;
+
+		double currentTime = t;
+
+		for (std::size_t i = 0; i < numCoarseSteps; ++i) {
+			if (options.coarse == Propagator::LeapFrog) {
+				// The fine steps sample the fields at the start of each of them, so the fields are
+				// taken in the middle of those sample times, not at the start of the coarse step
+				const double sampleTime = currentTime + (coarseStep - tStep) / 2;
+				vec3 EField = EFunc(sampleTime);
+				vec3 BField = BFunc(sampleTime);
+
+				double coarsePhase = std::min(stepsPerCoarseStep
+						* FinePhasePerStep(options.fine, BField, tStep), maxPararealCoarsePhase);
+				double h = std::fabs(charge) * BField.length() / (2 * mass) * coarseStep;
+				if (h > 0) {
+					// BorisPush turns the particle by 2 atan(h), so this makes it turn by coarsePhase
+					BField *= std::tan(coarsePhase / 2) / h;
+				}
+
+				state = BorisPush(state, EField, BField, coarseStep);
+			} else {
+				state = PropagatorStep(options.coarse, state, currentTime, coarseStep, EFunc, BFunc);
+			}
+			currentTime += coarseStep;
+		}
+
+		return state;
+	}
+
+	/**
+	 * This function measures how far apart two states are, relative to the given position and
+	 * momentum scales. Position and momentum live on wildly different scales (metres vs kg m/s),
+	 * so they have to be normalised separately before they can be compared against one tolerance.
+	 */
+	inline double RelativeDifference(const State& s1, const State& s2, const double positionScale,
+			const double momentumScale) {
+		double dx = (s1.getPosition() - s2.getPosition()).length() / positionScale;
+		double dp = (s1.getMomentum() - s2.getMomentum()).length() / momentumScale;
+		return std::max(dx, dp);
+	}
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires EMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+	 * This function runs the Parareal parallel-in-time scheme on the given problem. It produces the
+	 * same trajectory as running the fine propagator for numSteps steps of size tStep (up to the
+	 * tolerance), but splits the time interval into options.numSlices slices which are integrated
+	 * concurrently.
+	 *
+	 * Each iteration consists of a parallel sweep, where every slice that has not converged yet is
+	 * integrated with the fine propagator on its own thread, followed by a cheap serial sweep with
+	 * the coarse propagator which corrects the starting states of the slices:
+	 *
+	 *     U[n + 1] = G(U_new[n]) + F(U_old[n]) - G(U_old[n])
+	 *
+	 * The fine sweeps write directly into the returned vector, so no extra memory is needed for
+	 * the per-slice trajectories.
+	 *
+	 * Parareal only pays off if the coarse step can be a lot longer than the fine one, i.e. if the
+	 * fine step resolves the gyration much more finely than maxCoarsePhase. For the gyration in
+	 * the constant B field of main.cpp with 64 steps per turn, the default options converge in 2
+	 * iterations, which makes the critical path (see PararealResult) 2.9 times shorter than the
+	 * serial one with 8 slices, and 4.5 times shorter with 16. Fields which change noticeably over
+	 * a few turns need more iterations (4 to 5 for a B field varying by 20% every 60 turns), and
+	 * gain correspondingly less. An RK4 coarse propagator is held to such short steps (see
+	 * maxPararealRK4CoarsePhase) that it rarely converges within a few iterations, so the Boris
+	 * one is the default even when the fine propagator is RK4.
+	 *
+	 * main.cpp itself, on the other hand, takes only 4 steps per turn. A coarse step there can't
+	 * cover more than one fine step, so instead of doing the serial work several times over, the
+	 * driver falls back to the serial fine solver whenever the coarse step at t0 would be no
+	 * longer than the fine step.
+	 */
+	PararealResult Parareal(const State initialState, const double t0, const double tStep,
+			const std::size_t numSteps, Callable EFunc, Callable BFunc,
+			const PararealOptions& options = {}) {
+		PararealResult result;
+		result.values.resize(numSteps + 1);
+		result.iterations = 0;
+		result.converged = false;
+		result.criticalPathSteps = 0;
+
+		const std::size_t numSlices = std::max<std::size_t>(std::min(options.numSlices, numSteps), 1);
+		const std::size_t maxIterations = std::max<std::size_t>(options.maxIterations, 1);
+
+		if (numSlices == 1 || CoarseFactor(options, t0, tStep, BFunc) == 1) {
+			// Parareal can't beat the serial solver here (see above), so this just is the serial
+			// solver
+			result.values[0] = initialState;
+			double currentTime = t0;
+
+			for (std::size_t i = 0; i < numSteps; ++i) {
+				result.values[i + 1] = PropagatorStep(options.fine, result.values[i], currentTime,
+						tStep, EFunc, BFunc);
+				currentTime += tStep;
+			}
+
+			result.converged = true;
+			result.criticalPathSteps = numSteps;
+			return result;
+		}
+
+		// The steps are spread as evenly as possible over the slices. Slice n starts at the
+		// fine step sliceStart[n] and ends at the fine step sliceStart[n + 1].
+		std::vector<std::size_t> sliceStart(numSlices + 1);
+		for (std::size_t n = 0; n <= numSlices; ++n) {
+			sliceStart[n] = n * numSteps / numSlices;
+		}
+
+		auto sliceTime = [&](const std::size_t n) {
+			return t0 + sliceStart[n] * tStep;
+		};
+
+		auto sliceSteps = [&](const std::size_t n) {
+			return sliceStart[n + 1] - sliceStart[n];
+		};
+
+		// U holds the current guesses for the states at the start of each slice (and at the very
+		// end), and coarse holds G(U[n]), i.e. the coarse prediction for the end of slice n.
+		std::vector<State> U(numSlices + 1);
+		std::vector<State> coarse(numSlices);
+
+		auto coarseSteps = [&](const std::size_t n) {
+			return NumCoarseSteps(options, sliceTime(n), tStep, sliceSteps(n), BFunc);
+		};
+
+		U[0] = initialState;
+		for (std::size_t n = 0; n < numSlices; ++n) {
+			coarse[n] = CoarsePropagate(options, U[n], sliceTime(n), tStep, sliceSteps(n), EFunc, BFunc);
+			U[n + 1] = coarse[n];
+			result.criticalPathSteps += coarseSteps(n);
+		}
+
+		// Each fine sweep only writes the states strictly after the start of its slice. The state
+		// at the start of slice n is the end of slice n - 1, which is being written by another
+		// thread, so the sweep has to start from its own copy of U[n] instead.
+		result.values[0] = initialState;
+
+		auto fineSweep = [&](const std::size_t n) {
+			State state = U[n];
+			double currentTime = sliceTime(n);
+
+			for (std::size_t i = sliceStart[n]; i < sliceStart[n + 1]; ++i) {
+				state = PropagatorStep(options.fine, state, currentTime, tStep, EFunc, BFunc);
+				result.values[i + 1] = state;
+				currentTime += tStep;
+			}
+		};
+
+		// Slices before firstOpen have been integrated from their exact starting state, so their
+		// fine trajectories are final and they can be skipped in later sweeps.
+		std::size_t firstOpen = 0;
+
+		while (result.iterations < maxIterations && firstOpen < numSlices) {
+			// Parallel fine sweep. The last open slice is run on the calling thread instead of
+			// spawning yet another one.
+			std::vector<std::thread> workers;
+			workers.reserve(numSlices - firstOpen);
+			for (std::size_t n = firstOpen; n + 1 < numSlices; ++n) {
+				workers.emplace_back(fineSweep, n);
+			}
+			fineSweep(numSlices - 1);
+			for (auto& worker : workers) {
+				worker.join();
+			}
+
+			++result.iterations;
+
+			std::size_t longestSlice = 0;
+			for (std::size_t n = firstOpen; n < numSlices; ++n) {
+				longestSlice = std::max(longestSlice, sliceSteps(n));
+			}
+			result.criticalPathSteps += longestSlice;
+
+			// The scales used to judge convergence. The position scale is taken from the whole
+			// set of slice boundaries, since a gyrating particle passes through the origin.
+			double positionScale = 0;
+			double momentumScale = 0;
+			for (const auto& state : U) {
+				positionScale = std::max(positionScale, state.getPosition().length());
+				momentumScale = std::max(momentumScale, state.getMomentum().length());
+			}
+			if (positionScale == 0) {
+				positionScale = 1;
+			}
+			if (momentumScale == 0) {
+				momentumScale = 1;
+			}
+
+			// The fine trajectory is the answer once it has no jumps left, i.e. once every slice
+			// ends (close enough to) where the next one started. This is checked on the jumps
+			// rather than on how much U changed between iterations: a coarse propagator which
+			// is too crude to tell the starting states apart changes U by nothing at all, even
+			// though the slices don't fit together.
+			double maxJump = 0;
+			for (std::size_t n = firstOpen; n + 1 < numSlices; ++n) {
+				maxJump = std::max(maxJump, RelativeDifference(result.values[sliceStart[n + 1]],
+						U[n + 1], positionScale, momentumScale));
+			}
+
+			if (maxJump < options.tolerance) {
+				result.converged = true;
+				break;
+			}
+
+			// Serial coarse correction sweep. The end state of slice firstOpen comes from an exact
+			// starting state, so it is final as well.
+			U[firstOpen + 1] = result.values[sliceStart[firstOpen + 1]];
+
+			for (std::size_t n = firstOpen + 1; n < numSlices; ++n) {
+				State newCoarse = CoarsePropagate(options, U[n], sliceTime(n), tStep, sliceSteps(n),
+						EFunc, BFunc);
+				U[n + 1] = newCoarse + result.values[sliceStart[n + 1]] - coarse[n];
+				coarse[n] = newCoarse;
+				result.criticalPathSteps += coarseSteps(n);
+			}
+
+			++firstOpen;
+		}
+
+		// If every slice got integrated from its exact starting state, the result is exactly the
+		// serial fine solution.
+		if (firstOpen >= numSlices) {
+			result.converged = true;
+		}
+
+		return result;
+	}
+}
+#endif // PARAREAL_HPP
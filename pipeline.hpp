@@ -0,0 +1,266 @@
+#ifndef PIPELINE_HPP
+#define PIPELINE_HPP
+
+#include <cstddef> // for the std::size_t data type
+#include <array> // for std::array
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "concepts.hpp"
+#include "state.hpp"
+
+#include "propagator.hpp"
+
+namespace Solver {
+	/**
+	 * A bounded, lock-free queue for exactly one producer thread and one consumer thread.
+	 *
+	 * The queue is a ring buffer of Capacity slots. The producer only ever writes m_tail and the
+	 * consumer only ever writes m_head, so the two threads never wait on each other as long as the
+	 * queue is neither full nor empty. The two indices are kept on separate cache lines so that
+	 * the threads don't keep stealing the same cache line from each other.
+	 *
+	 * push and pop wait for room or for a value, respectively. They spin for a little while first
+	 * (the other thread is usually just about to get there), and then go to sleep on the index the
+	 * other thread moves, so that a thread which has nothing to do doesn't take CPU time away
+	 * from the ones which do.
+	 */
+	template <typename T, std::size_t Capacity>
+	class SPSCQueue {
+		static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0,
+				"The capacity of an SPSCQueue must be a power of two");
+
+		public:
+			SPSCQueue() : m_slots(Capacity) {}
+			SPSCQueue(const SPSCQueue&) = delete;
+			SPSCQueue& operator=(const SPSCQueue&) = delete;
+
+			// Returns false (and does nothing) if the queue is full
+			bool tryPush(const T& value) {
+				const std::size_t tail = m_tail.load(std::memory_order_relaxed);
+				if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+					return false;
+				}
+
+				m_slots[tail & (Capacity - 1)] = value;
+				m_tail.store(tail + 1, std::memory_order_release);
+#ifdef __cpp_lib_atomic_wait
+				m_tail.notify_one();
+#endif
+				return true;
+			}
+
+			// Returns false (and leaves value alone) if the queue is empty
+			bool tryPop(T& value) {
+				const std::size_t head = m_head.load(std::memory_order_relaxed);
+				if (head == m_tail.load(std::memory_order_acquire)) {
+					return false;
+				}
+
+				value = m_slots[head & (Capacity - 1)];
+				m_head.store(head + 1, std::memory_order_release);
+#ifdef __cpp_lib_atomic_wait
+				m_head.notify_one();
+#endif
+				return true;
+			}
+
+			// Waits for the consumer to make room if the queue is full
+			void push(const T& value) {
+				for (std::size_t spins = 0; !tryPush(value); ++spins) {
+					if (spins < maxSpins) {
+						continue;
+					}
+#ifdef __cpp_lib_atomic_wait
+					// The queue is full, so m_head is Capacity behind m_tail until the consumer
+					// takes something out
+					m_head.wait(m_tail.load(std::memory_order_relaxed) - Capacity,
+							std::memory_order_acquire);
+#else
+					std::this_thread::yield();
+#endif
+				}
+			}
+
+			// Waits for the producer to put something in if the queue is empty
+			void pop(T& value) {
+				for (std::size_t spins = 0; !tryPop(value); ++spins) {
+					if (spins < maxSpins) {
+						continue;
+					}
+#ifdef __cpp_lib_atomic_wait
+					// The queue is empty, so m_tail is where m_head is until the producer puts
+					// something in
+					m_tail.wait(m_head.load(std::memory_order_relaxed), std::memory_order_acquire);
+#else
+					std::this_thread::yield();
+#endif
+				}
+			}
+
+		private:
+			// How many times push and pop try again before they go to sleep
+			static constexpr std::size_t maxSpins = 64;
+
+			// The slots are on the heap, since a queue of StateBlocks is far too big for the stack
+			std::vector<T> m_slots;
+			alignas(64) std::atomic<std::size_t> m_head{0};
+			alignas(64) std::atomic<std::size_t> m_tail{0};
+	};
+
+	/**
+	 * A chunk of consecutive states of a trajectory, which is the unit the integrator hands over
+	 * to the analysis and output stages. Handing over whole blocks instead of single states keeps
+	 * the cost of the queue operations small compared to the cost of the integration itself.
+	 *
+	 * states[i] is the state after firstStep + i steps. A block with count == 0 marks the end of
+	 * the trajectory.
+	 */
+	struct StateBlock {
+		static constexpr std::size_t blockSize = 256;
+
+		std::size_t firstStep;
+		std::size_t count;
+		std::array<State, blockSize> states;
+	};
+
+	// How many blocks can be in flight between the integrator and each sink. This is what bounds
+	// the memory used by the pipeline: 16 blocks of 256 states is 192 KiB per sink.
+	constexpr std::size_t pipelineDepth = 16;
+
+	using StateBlockQueue = SPSCQueue<StateBlock, pipelineDepth>;
+
+	/**
+	 * Wrapping a sink in a LossySink tells the pipeline that the sink can do without some of the
+	 * states (e.g. a plot, or a progress display). When the queue of a lossy sink is full, the
+	 * integrator drops the block instead of waiting, so a slow lossy sink never slows the
+	 * integration down. The sink then simply sees a gap in firstStep, which decimates the
+	 * trajectory down to whatever rate the sink can keep up with.
+	 *
+	 * numDropped counts the blocks which were dropped. It is written by the integrator, so it
+	 * should only be read once Pipelined has returned.
+	 */
+	template <typename Sink>
+	struct LossySink {
+		Sink& sink;
+		std::size_t numDropped = 0;
+
+		void operator()(const StateBlock& block) {
+			sink(block);
+		}
+	};
+
+	/**
+	 * Hands a block over to the queue of a sink, with the policy the sink asked for. Sinks which
+	 * need every state get backpressure: if the queue is full, the integrator waits for the sink
+	 * to make room, so a sink which can't keep up slows the integrator down instead of letting
+	 * the queue grow without bound. Lossy sinks get the block dropped if they are behind.
+	 */
+	template <typename Sink>
+	void PublishBlock(StateBlockQueue& queue, const StateBlock& block, Sink& /* sink */) {
+		queue.push(block);
+	}
+
+	template <typename Sink>
+	void PublishBlock(StateBlockQueue& queue, const StateBlock& block, LossySink<Sink>& sink) {
+		if (!queue.tryPush(block)) {
+			++sink.numDropped;
+		}
+	}
+
+	/**
+	 * The loop each sink thread runs: it takes blocks out of its queue and hands them to the sink
+	 * until it sees the end marker.
+	 */
+	template <typename Sink>
+	void ConsumeBlocks(StateBlockQueue& queue, Sink& sink) {
+		StateBlock block;
+
+		while (true) {
+			queue.pop(block);
+			if (block.count == 0) {
+				break;
+			}
+			sink(block);
+		}
+	}
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable, typename... Sinks> requires EMFunc<Callable>
+#else
+	template <typename Callable, typename... Sinks>
+#endif
+	/**
+	 * This function runs the integration in pipelined mode. Instead of collecting the whole
+	 * trajectory in a std::vector and analysing it afterwards (like main.cpp does), the integrator
+	 * hands the trajectory over in StateBlocks to each of the sinks, which run concurrently on
+	 * their own threads. A sink is anything which can be called with a const StateBlock&, e.g. a
+	 * period finder, a momentum deviation tracker or a writer.
+	 *
+	 * Every sink gets its own SPSC queue, so a slow sink (like one writing to disk) doesn't hold up
+	 * the other sinks, and short bursts of slowness are absorbed by the queue without stalling the
+	 * integrator. If a sink which needs every state is slower than the integrator for good, the
+	 * integrator ends up waiting for it, which keeps the memory used by the pipeline bounded.
+	 * Sinks which can live with gaps should be wrapped in a LossySink, which bounds the memory by
+	 * dropping blocks instead, so the integrator runs at full speed no matter how slow they are.
+	 *
+	 * The sinks are taken by reference, so whatever they collected is still there after this
+	 * function returns. The return value is the state after the last step.
+	 */
+	State Pipelined(const State initialState, const double t0, const double tStep,
+			const std::size_t numSteps, Callable EFunc, Callable BFunc, const Propagator method,
+			Sinks&... sinks) {
+		std::array<StateBlockQueue, sizeof...(Sinks)> queues;
+		std::vector<std::thread> consumers;
+		consumers.reserve(sizeof...(Sinks));
+
+		{
+			std::size_t i = 0;
+			(consumers.emplace_back([&queue = queues[i++], &sinks] {
+				ConsumeBlocks(queue, sinks);
+			}), ...);
+		}
+
+		auto publish = [&](const StateBlock& block) {
+			std::size_t i = 0;
+			(PublishBlock(queues[i++], block, sinks), ...);
+		};
+
+		StateBlock block;
+		block.firstStep = 0;
+		block.count = 1;
+		block.states[0] = initialState;
+
+		State state = initialState;
+		double currentTime = t0;
+
+		for (std::size_t i = 0; i < numSteps; ++i) {
+			state = PropagatorStep(method, state, currentTime, tStep, EFunc, BFunc);
+			currentTime += tStep;
+
+			if (block.count == StateBlock::blockSize) {
+				publish(block);
+				block.firstStep += block.count;
+				block.count = 0;
+			}
+			block.states[block.count++] = state;
+		}
+
+		publish(block);
+
+		// The end marker, which even the lossy sinks have to get, or their threads would never end
+		block.firstStep += block.count;
+		block.count = 0;
+		for (auto& queue : queues) {
+			queue.push(block);
+		}
+
+		for (auto& consumer : consumers) {
+			consumer.join();
+		}
+
+		return state;
+	}
+}
+#endif // PIPELINE_HPP
@@ -0,0 +1,36 @@
+#ifndef PROPAGATOR_HPP
+#define PROPAGATOR_HPP
+
+#include "concepts.hpp"
+#include "state.hpp"
+
+#include "rk4.hpp"
+#include "leapfrog.hpp"
+
+namespace Solver {
+	/**
+	 * The two single step integrators which the drivers can be told to use at runtime,
+	 * e.g. as the coarse or fine propagator of Parareal, or as the integrator of the pipeline.
+	 */
+	enum class Propagator {
+		LeapFrog,
+		RK4
+	};
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires EMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+	 * This function does a single step with whichever propagator was asked for.
+	 */
+	State PropagatorStep(const Propagator method, const State& currentState, const double t,
+			const double tStep, Callable EFunc, Callable BFunc) {
+		if (method == Propagator::RK4) {
+			return RKStepper(currentState, t, tStep, EFunc, BFunc);
+		}
+		return LeapFrogStepper(currentState, t, tStep, EFunc, BFunc);
+	}
+}
+#endif // PROPAGATOR_HPP
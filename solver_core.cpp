@@ -0,0 +1,11 @@
+#include "solver_core.hpp"
+
+// The mass and charge of the particle are left to the program linking against the library (like
+// main.cpp), so that every program can track whichever particle it likes.
+
+namespace Solver {
+	SOLVER_CORE_INSTANTIATE_EMFUNC(, FieldPointer)
+	SOLVER_CORE_INSTANTIATE_EMFUNC(, FieldRef)
+	SOLVER_CORE_INSTANTIATE_SPATIAL_EMFUNC(, SpatialFieldPointer)
+	SOLVER_CORE_INSTANTIATE_SPATIAL_EMFUNC(, SpatialFieldRef)
+}
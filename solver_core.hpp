@@ -0,0 +1,72 @@
+#ifndef SOLVER_CORE_HPP
+#define SOLVER_CORE_HPP
+
+#include <cstddef> // for the std::size_t data type
+#include <array> // for std::array
+#include <vector>
+
+#include "state.hpp"
+#include "fieldref.hpp"
+
+#include "rk4.hpp"
+#include "leapfrog.hpp"
+#include "parareal.hpp"
+#include "subcycling.hpp"
+
+/**
+ * This header is the interface of the solver_core library. All the solvers are templates, so
+ * every translation unit which calls one of them with a new field type compiles its own copy.
+ * The library compiles them once for the field types which are used most often, and the extern
+ * template declarations below stop every user of this header from compiling them again.
+ *
+ * Calling a solver with any other field type still works as before, it just gets instantiated
+ * in the calling translation unit.
+ *
+ * The library doesn't define the mass and charge of the particle, so every program using it has
+ * to define them itself, just like main.cpp does.
+ */
+namespace Solver {
+	// A plain function like E and B in main.cpp, after it decays into a function pointer
+	using FieldPointer = std::array<double, 3> (*)(double);
+	// The spatially varying counterpart of FieldPointer
+	using SpatialFieldPointer = std::array<double, 3> (*)(std::array<double, 3>, double);
+}
+
+// The list of everything the library instantiates for a time-dependent field type. EXTERN is
+// either "extern" (for the declarations in this header) or empty (for the definitions in
+// solver_core.cpp), so that the two lists can never go out of sync.
+#define SOLVER_CORE_INSTANTIATE_EMFUNC(EXTERN, Callable) \
+	EXTERN template State functionEvaluator<Callable>(const State&, const double, \
+			Callable, Callable); \
+	EXTERN template State RKStepper<Callable>(const State&, const double, const double, \
+			Callable, Callable); \
+	EXTERN template std::vector<State> RK4<Callable>(const State, const double, const double, \
+			const std::size_t, Callable, Callable); \
+	EXTERN template State LeapFrogStepper<Callable>(const State&, const double, const double, \
+			Callable, Callable); \
+	EXTERN template std::vector<State> LeapFrog<Callable>(const State, const double, \
+			const double, const std::size_t, Callable, Callable); \
+	EXTERN template State PropagatorStep<Callable>(const Propagator, const State&, \
+			const double, const double, Callable, Callable); \
+	EXTERN template std::size_t CoarseFactor<Callable>(const PararealOptions&, const double, \
+			const double, Callable); \
+	EXTERN template std::size_t NumCoarseSteps<Callable>(const PararealOptions&, const double, \
+			const double, const std::size_t, Callable); \
+	EXTERN template State CoarsePropagate<Callable>(const PararealOptions&, State, \
+			const double, const double, const std::size_t, Callable, Callable); \
+	EXTERN template PararealResult Parareal<Callable>(const State, const double, const double, \
+			const std::size_t, Callable, Callable, const PararealOptions&);
+
+// The same for a field type which depends on the position as well as the time
+#define SOLVER_CORE_INSTANTIATE_SPATIAL_EMFUNC(EXTERN, Callable) \
+	EXTERN template SubcyclingResult Subcycling<Callable>(const std::vector<State>&, \
+			const double, const double, const std::size_t, Callable, Callable, \
+			const SubcyclingOptions&);
+
+namespace Solver {
+	SOLVER_CORE_INSTANTIATE_EMFUNC(extern, FieldPointer)
+	SOLVER_CORE_INSTANTIATE_EMFUNC(extern, FieldRef)
+	SOLVER_CORE_INSTANTIATE_SPATIAL_EMFUNC(extern, SpatialFieldPointer)
+	SOLVER_CORE_INSTANTIATE_SPATIAL_EMFUNC(extern, SpatialFieldRef)
+}
+#endif // SOLVER_CORE_HPP
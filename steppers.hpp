@@ -0,0 +1,202 @@
+#ifndef STEPPERS_HPP
+#define STEPPERS_HPP
+
+#include <cstddef> // for the std::size_t data type
+#include <array> // for std::array
+#include <optional>
+#include <string_view>
+#include <type_traits> // for std::decay_t
+#include <utility> // for std::index_sequence
+#include <variant>
+#include <vector>
+
+#include "boost/numeric/odeint.hpp" // for the Adams-Bashforth-Moulton method
+
+#include "concepts.hpp"
+#include "state.hpp"
+
+#include "rk4.hpp"
+#include "leapfrog.hpp"
+
+namespace Solver {
+	/**
+	 * The integration methods of this project, all behind the same interface (see the Stepper
+	 * concept in concepts.hpp). Each of them holds on to the E and B fields and advances a whole
+	 * group of particles by one step per call to doStep, so the loop over the particles is
+	 * compiled together with the method. For fields which are function objects, the step and the
+	 * fields can be inlined into that loop. For the field types solver_core comes precompiled for
+	 * (FieldPointer and FieldRef), every step is a call into the library instead, and the
+	 * fields are indirect calls anyway.
+	 */
+	template <typename Callable>
+	struct LeapFrogMethod {
+		static constexpr std::string_view name = "leapfrog";
+
+		Callable EFunc;
+		Callable BFunc;
+
+		// Single step methods keep no history, so there is nothing to forget
+		void reset(const std::size_t /* numParticles */) {}
+
+		void doStep(std::vector<State>& states, const double t, const double tStep) {
+			for (auto& state : states) {
+				state = LeapFrogStepper(state, t, tStep, EFunc, BFunc);
+			}
+		}
+	};
+
+	template <typename Callable>
+	struct RK4Method {
+		static constexpr std::string_view name = "rk4";
+
+		Callable EFunc;
+		Callable BFunc;
+
+		// Single step methods keep no history, so there is nothing to forget
+		void reset(const std::size_t /* numParticles */) {}
+
+		void doStep(std::vector<State>& states, const double t, const double tStep) {
+			for (auto& state : states) {
+				state = RKStepper(state, t, tStep, EFunc, BFunc);
+			}
+		}
+	};
+
+	/**
+	 * The 8th order Adams-Bashforth-Moulton method from Boost odeint, which main.cpp uses as the
+	 * reference solver. It is a multistep method, so every particle needs its own odeint stepper to
+	 * keep its history in. reset() throws the histories away, so it has to be called before every
+	 * run (IntegrateGroup does this), otherwise a group which is reused for new particles or a new
+	 * t0 would carry on from the derivatives of the previous run. After a reset, each stepper
+	 * starts itself up with a few RK4 steps, just like in main.cpp.
+	 */
+	template <typename Callable>
+	struct ABMMethod {
+		static constexpr std::string_view name = "abm";
+
+		// The state type odeint works with, same as StateType in main.cpp
+		using StateType = std::array<double, 6>;
+		using StepperType = boost::numeric::odeint::adams_bashforth_moulton<8, StateType>;
+
+		Callable EFunc;
+		Callable BFunc;
+		std::vector<StepperType> steppers = {};
+
+		void reset(const std::size_t numParticles) {
+			steppers.assign(numParticles, StepperType());
+		}
+
+		void doStep(std::vector<State>& states, const double t, const double tStep) {
+
+			// This is the update function of main.cpp, but for the fields held by this method
+			auto system = [this](const StateType& y, StateType& out, const double time) {
+				State current(y[0], y[1], y[2], y[3], y[4], y[5]);
+				functionEvaluator(current, time, EFunc, BFunc).toArray(out.data());
+			};
+
+			StateType in;
+			StateType out;
+			for (std::size_t i = 0; i < states.size(); ++i) {
+				states[i].toArray(in.data());
+				steppers[i].do_step(system, in, t, out, tStep);
+				states[i] = State(out[0], out[1], out[2], out[3], out[4], out[5]);
+			}
+		}
+	};
+
+	/**
+	 * The registry of all the methods. A method is registered by adding it to this list, and
+	 * everything below (looking methods up by name, dispatching to them) picks it up at compile
+	 * time.
+	 *
+	 * A run which mixes methods keeps one AnyMethod per group of particles. Choosing the method
+	 * at runtime only costs one std::visit per group per run (see IntegrateGroup), instead of a
+	 * virtual call per particle per step.
+	 */
+	template <typename Callable>
+	using AnyMethod = std::variant<LeapFrogMethod<Callable>, RK4Method<Callable>,
+			ABMMethod<Callable>>;
+
+	template <typename Callable, std::size_t... I>
+	constexpr std::array<std::string_view, sizeof...(I)> MethodNamesImpl(std::index_sequence<I...>) {
+		return {std::variant_alternative_t<I, AnyMethod<Callable>>::name...};
+	}
+
+	// The names of all registered methods, in the same order as in AnyMethod. The names don't
+	// depend on the field type, so any field type will do here.
+	constexpr auto MethodNames = MethodNamesImpl<std::array<double, 3> (*)(double)>(
+			std::make_index_sequence<std::variant_size_v<AnyMethod<std::array<double, 3> (*)(double)>>>());
+
+	template <typename Callable, std::size_t... I>
+	std::optional<AnyMethod<Callable>> MakeMethodImpl(const std::string_view name, Callable EFunc,
+			Callable BFunc, std::index_sequence<I...>) {
+		std::optional<AnyMethod<Callable>> method;
+
+		// Tries every registered method in turn, and constructs the one whose name matches
+		((name == std::variant_alternative_t<I, AnyMethod<Callable>>::name
+		  && (method.emplace(std::in_place_index<I>, EFunc, BFunc), true)) || ...);
+
+		return method;
+	}
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires EMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+	 * This function looks up a method by its name (one of MethodNames) and sets it up with the
+	 * given E and B fields. It returns an empty std::optional if there is no method by that name.
+	 */
+	std::optional<AnyMethod<Callable>> MakeMethod(const std::string_view name, Callable EFunc,
+			Callable BFunc) {
+		return MakeMethodImpl(name, EFunc, BFunc,
+				std::make_index_sequence<std::variant_size_v<AnyMethod<Callable>>>());
+	}
+
+	/**
+	 * A group of particles which are all integrated with the same method.
+	 */
+	template <typename Callable>
+	struct ParticleGroup {
+		AnyMethod<Callable> method;
+		std::vector<State> states;
+	};
+
+	/**
+	 * This function runs numSteps steps of whichever method the group uses on all of its
+	 * particles. The dispatch on the method happens once, outside of the loop over the steps, so
+	 * the loop itself is compiled separately for every method.
+	 *
+	 * Every call is a fresh run starting at t0: the method is reset first, so no history from an
+	 * earlier run of the same group leaks into this one.
+	 */
+	template <typename Callable>
+	void IntegrateGroup(ParticleGroup<Callable>& group, const double t0, const double tStep,
+			const std::size_t numSteps) {
+		std::visit([&](auto& stepper) {
+#ifdef __cpp_lib_concepts
+			static_assert(Stepper<std::decay_t<decltype(stepper)>>);
+#endif
+			stepper.reset(group.states.size());
+			double currentTime = t0;
+
+			for (std::size_t i = 0; i < numSteps; ++i) {
+				stepper.doStep(group.states, currentTime, tStep);
+				currentTime += tStep;
+			}
+		}, group.method);
+	}
+
+	/**
+	 * This function integrates every group of a mixed-method run in turn.
+	 */
+	template <typename Callable>
+	void IntegrateGroups(std::vector<ParticleGroup<Callable>>& groups, const double t0,
+			const double tStep, const std::size_t numSteps) {
+		for (auto& group : groups) {
+			IntegrateGroup(group, t0, tStep, numSteps);
+		}
+	}
+}
+#endif // STEPPERS_HPP
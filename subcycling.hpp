@@ -0,0 +1,167 @@
+#ifndef SUBCYCLING_HPP
+#define SUBCYCLING_HPP
+
+#include <cstddef> // for the std::size_t data type
+#include <algorithm> // for std::max and std::min
+#include <array> // for std::array
+#include <cmath> // for std::fabs, std::ceil and std::log2
+#include <vector>
+
+#include "concepts.hpp"
+#include "state.hpp"
+#include "vec3.hpp"
+
+#include "leapfrog.hpp"
+
+namespace Solver {
+	/**
+	 * The knobs of the subcycling solver.
+	 *
+	 * Every particle is pushed with a step of baseStep / 2^level, where the level is the smallest
+	 * one for which the particle turns by at most maxPhasePerStep radians around the B field in one
+	 * step. The level is capped at maxLevel (which itself is capped at maxSubcyclingLevel), so the
+	 * finest step the solver will ever take is baseStep / 2^maxLevel. A maxPhasePerStep which isn't
+	 * positive can't be met by any step, so it puts every particle in the finest bin.
+	 *
+	 * The particles are sorted into their bins again every rebinInterval base steps, to follow
+	 * them as they move between regions of weak and strong field.
+	 */
+	struct SubcyclingOptions {
+		double maxPhasePerStep = 0.1;
+		std::size_t maxLevel = 8;
+		std::size_t rebinInterval = 1;
+	};
+
+	// 2^32 substeps per base step is already far beyond anything sensible, and it keeps the number
+	// of substeps well within the range of std::size_t
+	constexpr std::size_t maxSubcyclingLevel = 32;
+
+	inline std::size_t SubcyclingMaxLevel(const SubcyclingOptions& options) {
+		return std::min(options.maxLevel, maxSubcyclingLevel);
+	}
+
+	/**
+	 * What the subcycling solver hands back: the states of all particles after the last base step,
+	 * the number of Boris pushes that were actually done, and the number of pushes a run with one
+	 * global step (the finest step any particle needed) would have done instead.
+	 */
+	struct SubcyclingResult {
+		std::vector<State> finalStates;
+		std::size_t numPushes;
+		std::size_t numUniformPushes;
+	};
+
+	/**
+	 * This function works out which step size bin a particle belongs in, from its local cyclotron
+	 * frequency omega = |q| |B| / m.
+	 */
+	inline std::size_t SubcyclingLevel(const vec3& BField, const double baseStep,
+			const SubcyclingOptions& options) {
+		const std::size_t maxLevel = SubcyclingMaxLevel(options);
+
+		if (!(options.maxPhasePerStep > 0)) {
+			return maxLevel;
+		}
+
+		double phasePerBaseStep = std::fabs(charge) * BField.length() / mass * baseStep;
+		double ratio = phasePerBaseStep / options.maxPhasePerStep;
+
+		// This also catches a NaN field
+		if (!(ratio > 1)) {
+			return 0;
+		}
+
+		// The level is capped while it is still a double, since a huge |B| (or an infinite ratio)
+		// would overflow the conversion to std::size_t
+		double level = std::min(std::ceil(std::log2(ratio)), static_cast<double>(maxLevel));
+		return static_cast<std::size_t>(level);
+	}
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires SpatialEMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+	 * This function runs the Boris LeapFrog algorithm on a whole beam of particles, but instead of
+	 * using one step size for all of them, it gives each particle a power-of-two fraction of
+	 * baseStep, depending on how strong the B field at its position is.
+	 *
+	 * The particles are grouped into bins by their level, and each bin is pushed as a batch: all
+	 * particles in bin l take 2^l substeps of baseStep / 2^l for every base step. Since the
+	 * particles don't interact with each other, all bins meet up again at the end of every base
+	 * step, which is also when the particles get re-binned.
+	 *
+	 * Unlike the other solvers, this one expects fields that depend on the position as well as the
+	 * time (see SpatialEMFunc in concepts.hpp), since with fields that are uniform in space every
+	 * particle would end up in the same bin anyway.
+	 */
+	SubcyclingResult Subcycling(const std::vector<State>& initialStates, const double t0,
+			const double baseStep, const std::size_t numBaseSteps, Callable EFunc, Callable BFunc,
+			const SubcyclingOptions& options = {}) {
+		SubcyclingResult result;
+		result.finalStates = initialStates;
+		result.numPushes = 0;
+		result.numUniformPushes = 0;
+
+		std::vector<State>& states = result.finalStates;
+		const std::size_t rebinInterval = std::max<std::size_t>(options.rebinInterval, 1);
+
+		// bins[l] holds the indices of all particles which are currently in level l. The indices
+		// stay sorted within a bin, so each batch walks through the states in memory order.
+		std::vector<std::vector<std::size_t>> bins(SubcyclingMaxLevel(options) + 1);
+
+		// The finest level any particle needed at any point of the run. A solver with one global
+		// step would have had to use this level for everyone, all the time.
+		std::size_t finestLevel = 0;
+
+		double currentTime = t0;
+
+		for (std::size_t step = 0; step < numBaseSteps; ++step) {
+			if (step % rebinInterval == 0) {
+				for (auto& bin : bins) {
+					bin.clear();
+				}
+
+				for (std::size_t i = 0; i < states.size(); ++i) {
+					vec3 BField = BFunc(states[i].getPosition().toStdArray(), currentTime);
+					std::size_t level = SubcyclingLevel(BField, baseStep, options);
+
+					bins[level].push_back(i);
+					finestLevel = std::max(finestLevel, level);
+				}
+			}
+
+			for (std::size_t level = 0; level < bins.size(); ++level) {
+				const auto& bin = bins[level];
+				if (bin.empty()) {
+					continue;
+				}
+
+				const std::size_t numSubsteps = std::size_t{1} << level;
+				const double subStep = baseStep / numSubsteps;
+				double subTime = currentTime;
+
+				for (std::size_t substep = 0; substep < numSubsteps; ++substep) {
+					for (const auto i : bin) {
+						auto position = states[i].getPosition().toStdArray();
+						vec3 EField = EFunc(position, subTime);
+						vec3 BField = BFunc(position, subTime);
+
+						states[i] = BorisPush(states[i], EField, BField, subStep);
+					}
+					subTime += subStep;
+				}
+
+				result.numPushes += bin.size() * numSubsteps;
+			}
+
+			currentTime += baseStep;
+		}
+
+		result.numUniformPushes = states.size() * numBaseSteps * (std::size_t{1} << finestLevel);
+
+		return result;
+	}
+}
+#endif // SUBCYCLING_HPP
@@ -0,0 +1,277 @@
+#ifndef TRAJECTORY_HPP
+#define TRAJECTORY_HPP
+
+#include <cstddef> // for the std::size_t data type
+#include <cstdint> // for std::uint8_t, std::int64_t and std::uint64_t
+#include <cmath> // for std::fabs, std::isfinite and std::llround
+#include <cstring> // for std::memcpy
+#include <stdexcept> // for std::range_error and std::invalid_argument
+#include <vector>
+
+#include "concepts.hpp"
+#include "state.hpp"
+
+#include "leapfrog.hpp"
+
+namespace Solver {
+	/**
+	 * The default predictor of CompressedTrajectory. It assumes the particle keeps going the way
+	 * it went during the last step, i.e. it extrapolates linearly from the last two states. It
+	 * doesn't need to know anything about the fields, so it works for any trajectory.
+	 */
+	struct LinearPredictor {
+		State operator()(const State& previous, const State& beforePrevious,
+				const std::size_t /* step */) const {
+			return 2.0 * previous - beforePrevious;
+		}
+	};
+
+#ifdef __cpp_lib_concepts
+	template <typename Callable> requires EMFunc<Callable>
+#else
+	template <typename Callable>
+#endif
+	/**
+	 * A predictor which redoes the Boris step from the previous state. For a trajectory which was
+	 * produced by Solver::LeapFrog with the same fields and step size, the predictions are only
+	 * off by the quantisation error of the previous state, so almost every residual ends up as a
+	 * single byte.
+	 */
+	struct BorisPredictor {
+		Callable EFunc;
+		Callable BFunc;
+		double t0;
+		double tStep;
+
+		State operator()(const State& previous, const State& /* beforePrevious */,
+				const std::size_t step) const {
+			return LeapFrogStepper(previous, t0 + (step - 1) * tStep, tStep, EFunc, BFunc);
+		}
+	};
+
+	/**
+	 * A lossy, compressed replacement for the std::vector<State> the solvers return, for runs which
+	 * are too long (or have too many particles) to keep every state around at 48 bytes apiece.
+	 *
+	 * The states are stored in blocks of blockSize. The first state of every block is stored as is,
+	 * and every other state is stored as the difference between it and what the Predictor expected
+	 * it to be from the states before it, rounded to a multiple of twice the error bound. Each of
+	 * those residuals is then written out as a variable length integer, so the better the
+	 * predictions, the fewer bytes a state takes.
+	 *
+	 * Every position component comes back within positionError of the original, and every momentum
+	 * component within momentumError. The predictions are made from the decoded states rather than
+	 * the originals, so the error does not build up along the trajectory. Both bounds have to be
+	 * positive and finite, so there is no lossless setting. The decoded values are doubles as
+	 * well, so a bound smaller than half an ulp of the values being stored can't be kept either:
+	 * the rounding of the decoded value alone is already bigger than that.
+	 *
+	 * Looking up a state only has to decode the block it is in, whose start is found through the
+	 * block index, so trajectory[i] costs at most blockSize decoding steps no matter how long the
+	 * trajectory is.
+	 */
+	template <typename Predictor = LinearPredictor>
+	class CompressedTrajectory {
+		public:
+			static constexpr std::size_t blockSize = 64;
+
+			CompressedTrajectory(const double positionError, const double momentumError,
+					Predictor predictor = {}) :
+				m_quantum{2 * positionError, 2 * positionError, 2 * positionError,
+						  2 * momentumError, 2 * momentumError, 2 * momentumError},
+				m_predictor(predictor) {
+				if (!(positionError > 0 && std::isfinite(positionError))
+						|| !(momentumError > 0 && std::isfinite(momentumError))) {
+					throw std::invalid_argument("CompressedTrajectory: the error bounds must be "
+							"positive and finite");
+				}
+			}
+
+			// If this throws (either std::range_error because the error bound can't be kept, or
+			// std::bad_alloc), the trajectory is left exactly as it was before the call, so the
+			// caller can carry on pushing states
+			void push_back(const State& state) {
+				const std::size_t oldBytes = m_bytes.size();
+
+				if (m_size % blockSize == 0) {
+					// The first state of a block is stored as it is
+					m_bytes.resize(oldBytes + sizeof(State));
+					std::memcpy(&m_bytes[oldBytes], &state, sizeof(State));
+
+					try {
+						m_blockOffsets.push_back(oldBytes);
+					} catch (...) {
+						m_bytes.resize(oldBytes);
+						throw;
+					}
+
+					m_previous = state;
+					m_beforePrevious = state;
+				} else {
+					State predicted = m_predictor(m_previous, m_beforePrevious, m_size);
+					State decoded;
+					std::int64_t residuals[6];
+
+					// All six residuals are checked before any of them gets written, so that a
+					// state which can't be stored doesn't leave half of itself behind in m_bytes
+					for (auto k = 0; k < 6; ++k) {
+						double quanta = (state[k] - predicted[k]) / m_quantum[k];
+						if (!(std::fabs(quanta) < maxQuanta)) {
+							throw std::range_error("CompressedTrajectory: the error bound is too "
+									"small for the distance between the prediction and the state");
+						}
+
+						residuals[k] = std::llround(quanta);
+						decoded[k] = predicted[k] + residuals[k] * m_quantum[k];
+					}
+
+					try {
+						for (auto k = 0; k < 6; ++k) {
+							writeVarint(zigzag(residuals[k]));
+						}
+					} catch (...) {
+						m_bytes.resize(oldBytes);
+						throw;
+					}
+
+					m_beforePrevious = m_previous;
+					m_previous = decoded;
+				}
+
+				++m_size;
+			}
+
+			State operator[](const std::size_t i) const {
+				State previous;
+				State beforePrevious;
+				std::size_t position = m_blockOffsets[i / blockSize];
+
+				decodeKeyframe(position, previous);
+				beforePrevious = previous;
+
+				for (std::size_t step = i - i % blockSize + 1; step <= i; ++step) {
+					State decoded = decodeStep(position, previous, beforePrevious, step);
+					beforePrevious = previous;
+					previous = decoded;
+				}
+
+				return previous;
+			}
+
+			// Decodes the whole trajectory in one go, which is much cheaper than looking up every
+			// state on its own with operator[]
+			std::vector<State> decode() const {
+				std::vector<State> values;
+				values.reserve(m_size);
+
+				std::size_t position = 0;
+				State previous;
+				State beforePrevious;
+
+				for (std::size_t step = 0; step < m_size; ++step) {
+					if (step % blockSize == 0) {
+						decodeKeyframe(position, previous);
+						beforePrevious = previous;
+						values.push_back(previous);
+						continue;
+					}
+
+					State decoded = decodeStep(position, previous, beforePrevious, step);
+					beforePrevious = previous;
+					previous = decoded;
+					values.push_back(decoded);
+				}
+
+				return values;
+			}
+
+			std::size_t size() const {
+				return m_size;
+			}
+
+			// The bytes taken up by the encoded states and the block index
+			std::size_t compressedBytes() const {
+				return m_bytes.size() + m_blockOffsets.size() * sizeof(std::size_t);
+			}
+
+			// The bytes the same states would take up in a std::vector<State>
+			std::size_t uncompressedBytes() const {
+				return m_size * sizeof(State);
+			}
+
+			double compressionRatio() const {
+				return static_cast<double>(uncompressedBytes()) / compressedBytes();
+			}
+
+		private:
+			// Residuals have to fit into an std::int64_t (with room to spare for the zigzag
+			// encoding), otherwise the error bound can't be kept
+			static constexpr double maxQuanta = 4.6e18;
+
+			// Maps small negative and positive numbers to small unsigned numbers (0, -1, 1, -2, 2
+			// becomes 0, 1, 2, 3, 4), so that both take only a few bytes as a varint
+			static constexpr std::uint64_t zigzag(const std::int64_t n) {
+				return (static_cast<std::uint64_t>(n) << 1) ^ static_cast<std::uint64_t>(n >> 63);
+			}
+
+			static constexpr std::int64_t unzigzag(const std::uint64_t n) {
+				return static_cast<std::int64_t>(n >> 1) ^ -static_cast<std::int64_t>(n & 1);
+			}
+
+			// Writes n 7 bits at a time, with the top bit of every byte saying whether another
+			// byte follows
+			void writeVarint(std::uint64_t n) {
+				while (n >= 0x80) {
+					m_bytes.push_back(static_cast<std::uint8_t>(n | 0x80));
+					n >>= 7;
+				}
+				m_bytes.push_back(static_cast<std::uint8_t>(n));
+			}
+
+			std::uint64_t readVarint(std::size_t& position) const {
+				std::uint64_t n = 0;
+				int shift = 0;
+
+				while (m_bytes[position] & 0x80) {
+					n |= static_cast<std::uint64_t>(m_bytes[position++] & 0x7f) << shift;
+					shift += 7;
+				}
+				n |= static_cast<std::uint64_t>(m_bytes[position++]) << shift;
+
+				return n;
+			}
+
+			void decodeKeyframe(std::size_t& position, State& state) const {
+				std::memcpy(&state, &m_bytes[position], sizeof(State));
+				position += sizeof(State);
+			}
+
+			// This has to do exactly the same arithmetic as push_back, so that the decoder makes
+			// the same predictions the encoder made
+			State decodeStep(std::size_t& position, const State& previous,
+					const State& beforePrevious, const std::size_t step) const {
+				State predicted = m_predictor(previous, beforePrevious, step);
+				State decoded;
+
+				for (auto k = 0; k < 6; ++k) {
+					std::int64_t residual = unzigzag(readVarint(position));
+					decoded[k] = predicted[k] + residual * m_quantum[k];
+				}
+
+				return decoded;
+			}
+
+			double m_quantum[6];
+			Predictor m_predictor;
+
+			std::vector<std::uint8_t> m_bytes;
+			// m_blockOffsets[b] is where block b starts in m_bytes
+			std::vector<std::size_t> m_blockOffsets;
+			std::size_t m_size = 0;
+
+			// The last two decoded states, which the encoder makes its next prediction from
+			State m_previous;
+			State m_beforePrevious;
+	};
+}
+#endif // TRAJECTORY_HPP
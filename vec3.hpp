@@ -42,6 +42,12 @@ class vec3 {
 			}
 		}
 
+		constexpr std::array<double, 3> toStdArray() const {
+			// The inverse of the std::array constructor above. This is what the
+			// spatially varying E and B functions take as their position argument.
+			return {m_e[0], m_e[1], m_e[2]};
+		}
+
 		// Arithmetic operator overloads
 		constexpr vec3 operator-() const {
 			return {-m_e[0], -m_e[1], -m_e[2]};